@@ -1,6 +1,9 @@
 #include <Windows.h>
 #include <Dbt.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #define JFBJOY_DINPUT
 #define JFBJOY_IMPLEMENTATION
 #include "jfb_joystick.h"
@@ -40,7 +43,188 @@ bool inputPressed(Joystick* joysticks, uint joystickCount, uint* out_inputCode)
 	return false;
 }
 
-void outputButtonMapping(uint inputCode)
+const uint maxJournalEdits = 64;
+// How long to wait after the last press before writing the journal to disk
+const DWORD journalFlushDelay = 1000;
+// How long to wait for the text editor to put the copied line on the clipboard
+const DWORD clipboardTimeout = 250;
+const uint maxSavedClipboardFormats = 64;
+// Messages for the input watcher thread
+const UINT watchInputMessage = WM_APP + 0;
+const UINT stopWatchingInputMessage = WM_APP + 1;
+
+enum HotKey
+{
+	HotKey_undo = 1,
+	HotKey_redo,
+};
+// Ctrl+Shift rather than Ctrl+Alt, which is AltGr on many keyboard layouts
+const UINT hotKeyModifiers = MOD_CONTROL | MOD_SHIFT;
+const UINT undoHotKey = VK_F9;
+const UINT redoHotKey = VK_F10;
+
+struct MappingEdit
+{
+	// Text editor the mapping was typed into
+	HWND window;
+	int line;
+	// Text of the line before the mapping was typed, so it can be found by hand
+	char lineText[128];
+	bool oldCodeKnown;
+	uint oldCode;
+	uint newCode;
+};
+
+// Edits are kept in a ring buffer. The first `count` edits from `first` are applied,
+// the ones after that up to `total` have been undone and can be redone.
+struct MappingJournal
+{
+	MappingEdit edits[maxJournalEdits];
+	uint first;
+	uint count;
+	uint total;
+	// Line of the cursor relative to where the first edit in the history was made
+	int cursorLine;
+	// Input watcher epoch when the history was started
+	LONG inputEpoch;
+	bool watchingInput;
+	// Why the last edit, undo or redo couldn't be kept or replayed, shown in the window title
+	const char* notice;
+
+	// Log text waiting to be written, so a burst of presses costs one write and one flush
+	char path[MAX_PATH];
+	char pendingText[16384];
+	uint pendingLength;
+	DWORD lastEditTime;
+	bool writeFailed;
+	// Entries that didn't fit in the buffer since the last "entries lost" line, and in total
+	uint droppedEntries;
+	uint lostEntries;
+};
+
+struct SavedClipboard
+{
+	UINT formats[maxSavedClipboardFormats];
+	HGLOBAL data[maxSavedClipboardFormats];
+	uint count;
+};
+
+// Watches for keys and clicks from the user, which can move the cursor in the editor
+// after which the history no longer knows which lines its edits are on. The hooks run
+// on their own thread so input across the whole system never waits on the main loop.
+struct InputWatcher
+{
+	HANDLE thread;
+	DWORD threadId;
+	// Signaled when the thread has handled a request
+	HANDLE requestDone;
+	bool hooked;
+	HHOOK keyboardHook;
+	HHOOK mouseHook;
+	// Incremented for every key or click from the user
+	volatile LONG epoch;
+};
+
+InputWatcher global_inputWatcher = { 0 };
+
+bool isModifierKey(DWORD key)
+{
+	return key == VK_SHIFT || key == VK_LSHIFT || key == VK_RSHIFT
+		|| key == VK_CONTROL || key == VK_LCONTROL || key == VK_RCONTROL
+		|| key == VK_MENU || key == VK_LMENU || key == VK_RMENU;
+}
+
+LRESULT CALLBACK KeyboardHook(int code, WPARAM wParam, LPARAM lParam)
+{
+	KBDLLHOOKSTRUCT* key = (KBDLLHOOKSTRUCT*)lParam;
+	if (code == HC_ACTION && (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) && !(key->flags & LLKHF_INJECTED)) {
+		bool hotKey = (key->vkCode == undoHotKey || key->vkCode == redoHotKey)
+			&& (GetAsyncKeyState(VK_CONTROL) & 0x8000) && (GetAsyncKeyState(VK_SHIFT) & 0x8000);
+		if (!hotKey && !isModifierKey(key->vkCode)) {
+			InterlockedIncrement(&global_inputWatcher.epoch);
+		}
+	}
+	return CallNextHookEx(0, code, wParam, lParam);
+}
+
+LRESULT CALLBACK MouseHook(int code, WPARAM wParam, LPARAM lParam)
+{
+	MSLLHOOKSTRUCT* mouse = (MSLLHOOKSTRUCT*)lParam;
+	if (code == HC_ACTION && (wParam == WM_LBUTTONDOWN || wParam == WM_RBUTTONDOWN || wParam == WM_MBUTTONDOWN) && !(mouse->flags & LLMHF_INJECTED)) {
+		InterlockedIncrement(&global_inputWatcher.epoch);
+	}
+	return CallNextHookEx(0, code, wParam, lParam);
+}
+
+void unhookInput(InputWatcher* watcher)
+{
+	if (watcher->keyboardHook) UnhookWindowsHookEx(watcher->keyboardHook);
+	if (watcher->mouseHook) UnhookWindowsHookEx(watcher->mouseHook);
+	watcher->keyboardHook = 0;
+	watcher->mouseHook = 0;
+	watcher->hooked = false;
+}
+
+DWORD WINAPI inputWatcherThread(void* parameter)
+{
+	InputWatcher* watcher = (InputWatcher*)parameter;
+	HINSTANCE instance = GetModuleHandle(0);
+	// Create the message queue before telling the main thread it can post to it
+	MSG msg;
+	PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+	SetEvent(watcher->requestDone);
+
+	while (GetMessage(&msg, NULL, 0, 0) > 0) {
+		if (msg.message == watchInputMessage && !watcher->hooked) {
+			watcher->keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardHook, instance, 0);
+			watcher->mouseHook = SetWindowsHookEx(WH_MOUSE_LL, MouseHook, instance, 0);
+			watcher->hooked = watcher->keyboardHook && watcher->mouseHook;
+			if (!watcher->hooked) unhookInput(watcher);
+		}
+		if (msg.message == stopWatchingInputMessage) {
+			unhookInput(watcher);
+		}
+		SetEvent(watcher->requestDone);
+	}
+	unhookInput(watcher);
+	return 0;
+}
+
+bool startInputWatcher(InputWatcher* watcher)
+{
+	watcher->requestDone = CreateEvent(0, FALSE, FALSE, 0);
+	if (!watcher->requestDone) return false;
+	watcher->thread = CreateThread(0, 0, inputWatcherThread, watcher, 0, &watcher->threadId);
+	if (!watcher->thread) {
+		CloseHandle(watcher->requestDone);
+		watcher->requestDone = 0;
+		return false;
+	}
+	WaitForSingleObject(watcher->requestDone, INFINITE);
+	return true;
+}
+
+// Waits for the hooks to be in place, so no input is missed once this returns true
+bool setInputWatched(InputWatcher* watcher, bool watch)
+{
+	if (!watcher->thread) return false;
+	if (!PostThreadMessage(watcher->threadId, watch ? watchInputMessage : stopWatchingInputMessage, 0, 0)) return false;
+	if (WaitForSingleObject(watcher->requestDone, 1000) != WAIT_OBJECT_0) return false;
+	return watcher->hooked;
+}
+
+LONG currentInputEpoch(InputWatcher* watcher)
+{
+	return InterlockedCompareExchange(&watcher->epoch, 0, 0);
+}
+
+void tapKey(BYTE key)
+{
+	keybd_event(key, 0, 0, NULL);
+	keybd_event(key, 0, KEYEVENTF_KEYUP, NULL);
+}
+
+void selectAndTypeMapping(uint code)
 {
 	// Select previous mapping
 	keybd_event(VK_SHIFT, 0, 0, NULL);
@@ -54,17 +238,382 @@ void outputButtonMapping(uint inputCode)
 
 	// Type in new mapping
 	char buffer[4];
-	sprintf_s(buffer, "%03x", inputCode);
+	sprintf_s(buffer, "%03x", code);
 	keybd_event(buffer[0], 0, 0, NULL);
 	keybd_event(buffer[0], 0, KEYEVENTF_KEYUP, NULL);
 	keybd_event(buffer[1], 0, 0, NULL);
 	keybd_event(buffer[1], 0, KEYEVENTF_KEYUP, NULL);
 	keybd_event(buffer[2], 0, 0, NULL);
 	keybd_event(buffer[2], 0, KEYEVENTF_KEYUP, NULL);
+}
+
+// Only used by undo and redo, which only run while the editor is focused
+void moveCursorToLine(MappingJournal* journal, int line)
+{
+	for (; journal->cursorLine < line; ++journal->cursorLine) tapKey(VK_DOWN);
+	for (; journal->cursorLine > line; --journal->cursorLine) tapKey(VK_UP);
+	// Lines can have different lengths, so make sure the cursor is after the mapping
+	tapKey(VK_END);
+}
+
+// Notepad hides the .ini extension from its title by default, so recognize it by its window class
+bool isConfigEditor(HWND window)
+{
+	char text[256];
+	if (!window) return false;
+	if (GetClassNameA(window, text, sizeof(text))) {
+		if (strcmp(text, "Notepad") == 0 || strcmp(text, "Notepad++") == 0) return true;
+	}
+	if (!GetWindowTextA(window, text, sizeof(text))) return false;
+	CharLowerA(text);
+	return strstr(text, ".ini") != 0;
+}
+
+bool openClipboard(HWND window)
+{
+	// The editor may still have the clipboard open right after copying
+	forloop(attempt, 10) {
+		if (OpenClipboard(window)) return true;
+		Sleep(5);
+	}
+	return false;
+}
+
+// GDI and private formats hold handles that can't be copied as plain memory
+bool isMemoryClipboardFormat(UINT format)
+{
+	switch (format) {
+		case CF_BITMAP: case CF_DSPBITMAP: case CF_PALETTE: case CF_OWNERDISPLAY:
+		case CF_METAFILEPICT: case CF_DSPMETAFILEPICT: case CF_ENHMETAFILE: case CF_DSPENHMETAFILE:
+			return false;
+	}
+	if (format >= CF_PRIVATEFIRST && format <= CF_PRIVATELAST) return false;
+	if (format >= CF_GDIOBJFIRST && format <= CF_GDIOBJLAST) return false;
+	return true;
+}
+
+void freeSavedClipboard(SavedClipboard* saved)
+{
+	forloop(i, saved->count) {
+		if (saved->data[i]) GlobalFree(saved->data[i]);
+	}
+	saved->count = 0;
+}
+
+// Copying the line goes through the user's clipboard, so everything on it is copied out first.
+// Formats the owner renders on demand are rendered here, and the copy made by the editor still
+// shows up in clipboard history; only the restore is kept out of it.
+bool saveClipboard(HWND window, SavedClipboard* saved)
+{
+	saved->count = 0;
+	if (!openClipboard(window)) return false;
+	bool complete = true;
+	UINT format = 0;
+	while ((format = EnumClipboardFormats(format)) != 0) {
+		if (!isMemoryClipboardFormat(format)) continue;
+		if (saved->count == maxSavedClipboardFormats) {
+			complete = false;
+			break;
+		}
+		HANDLE data = GetClipboardData(format);
+		SIZE_T size = data ? GlobalSize(data) : 0;
+		void* source = size ? GlobalLock(data) : 0;
+		if (!source) continue;
+
+		HGLOBAL copy = GlobalAlloc(GMEM_MOVEABLE, size);
+		void* destination = copy ? GlobalLock(copy) : 0;
+		if (destination) {
+			memcpy(destination, source, size);
+			GlobalUnlock(copy);
+			saved->formats[saved->count] = format;
+			saved->data[saved->count] = copy;
+			++saved->count;
+		}
+		else {
+			if (copy) GlobalFree(copy);
+			complete = false;
+		}
+		GlobalUnlock(data);
+		if (!complete) break;
+	}
+	CloseClipboard();
+	if (!complete) freeSavedClipboard(saved);
+	return complete;
+}
 
-	// Move cursor to next line
-	keybd_event(VK_DOWN, 0, 0, NULL);
-	keybd_event(VK_DOWN, 0, KEYEVENTF_KEYUP, NULL);
+void restoreClipboard(HWND window, SavedClipboard* saved)
+{
+	if (openClipboard(window)) {
+		EmptyClipboard();
+		forloop(i, saved->count) {
+			// The clipboard owns the memory once it has been set
+			if (SetClipboardData(saved->formats[i], saved->data[i])) saved->data[i] = 0;
+		}
+		// Keep clipboard history, cloud sync and clipboard managers from recording the restore
+		HGLOBAL exclude = GlobalAlloc(GMEM_MOVEABLE, sizeof(DWORD));
+		if (exclude && !SetClipboardData(RegisterClipboardFormatA("ExcludeClipboardContentFromMonitorProcessing"), exclude)) {
+			GlobalFree(exclude);
+		}
+		CloseClipboard();
+	}
+	freeSavedClipboard(saved);
+}
+
+// Copies the line the cursor is at the end of, leaving the cursor and the user's clipboard as they were
+bool copyCurrentLine(HWND window, char* out_text, uint size)
+{
+	out_text[0] = 0;
+	SavedClipboard saved;
+	// Without a copy of the clipboard it can't be put back, so don't touch it
+	if (!saveClipboard(window, &saved)) return false;
+	DWORD sequence = GetClipboardSequenceNumber();
+
+	keybd_event(VK_SHIFT, 0, 0, NULL);
+	tapKey(VK_HOME);
+	keybd_event(VK_SHIFT, 0, KEYEVENTF_KEYUP, NULL);
+	keybd_event(VK_CONTROL, 0, 0, NULL);
+	tapKey('C');
+	keybd_event(VK_CONTROL, 0, KEYEVENTF_KEYUP, NULL);
+	tapKey(VK_END);
+
+	DWORD start = GetTickCount();
+	while (GetClipboardSequenceNumber() == sequence && GetTickCount() - start < clipboardTimeout) {
+		Sleep(1);
+	}
+	if (GetClipboardSequenceNumber() == sequence) {
+		// The copy never happened, so the clipboard still holds the user's data
+		freeSavedClipboard(&saved);
+		return false;
+	}
+
+	bool copied = false;
+	if (openClipboard(window)) {
+		HANDLE data = GetClipboardData(CF_TEXT);
+		const char* text = data ? (const char*)GlobalLock(data) : 0;
+		if (text) {
+			// A truncated line would lose the mapping at its end
+			copied = strncpy_s(out_text, size, text, _TRUNCATE) == 0;
+			GlobalUnlock(data);
+		}
+		CloseClipboard();
+	}
+	restoreClipboard(window, &saved);
+	return copied;
+}
+
+bool parseMappingCode(const char* lineText, uint* out_code)
+{
+	size_t length = strlen(lineText);
+	if (length < 3) return false;
+	const char* digits = lineText + length - 3;
+	forloop(i, 3) {
+		if (!isxdigit((unsigned char)digits[i])) return false;
+	}
+	*out_code = strtoul(digits, 0, 16);
+	return true;
+}
+
+bool appendJournalText(MappingJournal* journal, const char* text, uint length)
+{
+	if (journal->pendingLength + length > sizeof(journal->pendingText)) return false;
+	memcpy(journal->pendingText + journal->pendingLength, text, length);
+	journal->pendingLength += length;
+	return true;
+}
+
+// Mark where entries were dropped, so the log doesn't quietly have gaps
+void appendLostEntriesLine(MappingJournal* journal)
+{
+	if (journal->droppedEntries == 0) return;
+	char line[64];
+	int length = sprintf_s(line, "%u entries lost, the log couldn't be written\r\n", journal->droppedEntries);
+	if (length > 0 && appendJournalText(journal, line, length)) {
+		journal->droppedEntries = 0;
+	}
+}
+
+bool flushJournal(MappingJournal* journal)
+{
+	appendLostEntriesLine(journal);
+	if (journal->pendingLength == 0) return true;
+
+	bool flushed = false;
+	HANDLE file = CreateFileA(journal->path, FILE_APPEND_DATA, FILE_SHARE_READ, 0, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file != INVALID_HANDLE_VALUE) {
+		DWORD bytesWritten = 0;
+		BOOL written = WriteFile(file, journal->pendingText, journal->pendingLength, &bytesWritten, 0);
+		// Keep whatever didn't make it to the file so the next flush retries it
+		memmove(journal->pendingText, journal->pendingText + bytesWritten, journal->pendingLength - bytesWritten);
+		journal->pendingLength -= bytesWritten;
+		flushed = written && journal->pendingLength == 0 && FlushFileBuffers(file);
+		CloseHandle(file);
+	}
+	journal->writeFailed = !flushed;
+	// Wait before retrying a failed write instead of trying every frame
+	journal->lastEditTime = GetTickCount();
+	return flushed;
+}
+
+void logEdit(MappingJournal* journal, const char* action, MappingEdit& edit, bool reverse)
+{
+	char title[128] = "";
+	GetWindowTextA(edit.window, title, sizeof(title));
+	char oldCode[4] = "???";
+	if (edit.oldCodeKnown) sprintf_s(oldCode, "%03x", edit.oldCode);
+	char newCode[4];
+	sprintf_s(newCode, "%03x", edit.newCode);
+
+	char line[512];
+	SYSTEMTIME time;
+	GetLocalTime(&time);
+	int length = sprintf_s(line, "%04d-%02d-%02d %02d:%02d:%02d.%03d %s [%s] %s: %s -> %s\r\n",
+		time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond, time.wMilliseconds,
+		action, title, edit.lineText, reverse ? newCode : oldCode, reverse ? oldCode : newCode);
+	if (length <= 0) return;
+
+	if (journal->pendingLength + (uint)length > sizeof(journal->pendingText)) {
+		flushJournal(journal);
+	}
+	appendLostEntriesLine(journal);
+	if (journal->droppedEntries > 0 || !appendJournalText(journal, line, length)) {
+		++journal->droppedEntries;
+		++journal->lostEntries;
+		return;
+	}
+	journal->lastEditTime = GetTickCount();
+}
+
+uint journalIndex(MappingJournal* journal, uint i)
+{
+	return (journal->first + i) % maxJournalEdits;
+}
+
+// Forget the history once the cursor can no longer be trusted to be where the program left it
+void clearJournalHistory(MappingJournal* journal)
+{
+	journal->first = 0;
+	journal->count = 0;
+	journal->total = 0;
+	journal->cursorLine = 0;
+	if (journal->watchingInput) {
+		setInputWatched(&global_inputWatcher, false);
+		journal->watchingInput = false;
+	}
+}
+
+// Returns false and clears the history if the user has typed or clicked since it was started
+bool checkJournalHistory(MappingJournal* journal)
+{
+	if (journal->total > 0 && currentInputEpoch(&global_inputWatcher) != journal->inputEpoch) {
+		clearJournalHistory(journal);
+		return false;
+	}
+	return true;
+}
+
+void outputButtonMapping(MappingJournal* journal, HWND window, bool undoAvailable, uint inputCode)
+{
+	// Only keep a history while mapping in the config file, not while playing
+	HWND editor = GetForegroundWindow();
+	if (!isConfigEditor(editor)) {
+		selectAndTypeMapping(inputCode);
+		tapKey(VK_DOWN);
+		return;
+	}
+	checkJournalHistory(journal);
+	if (journal->total > 0 && journal->edits[journalIndex(journal, 0)].window != editor) {
+		clearJournalHistory(journal);
+	}
+
+	MappingEdit edit = { 0 };
+	edit.window = editor;
+	edit.line = journal->cursorLine;
+	edit.newCode = inputCode;
+
+	// Start watching for the user's input before reading the line the history starts from
+	bool keepHistory = undoAvailable;
+	if (keepHistory && journal->total == 0) {
+		journal->watchingInput = setInputWatched(&global_inputWatcher, true);
+		keepHistory = journal->watchingInput;
+		journal->inputEpoch = currentInputEpoch(&global_inputWatcher);
+		journal->notice = keepHistory ? 0 : "can't watch input, undo unavailable";
+	}
+
+	if (copyCurrentLine(window, edit.lineText, sizeof(edit.lineText))) {
+		edit.oldCodeKnown = parseMappingCode(edit.lineText, &edit.oldCode);
+	}
+	logEdit(journal, "map ", edit, false);
+	selectAndTypeMapping(inputCode);
+	tapKey(VK_DOWN);
+
+	if (!keepHistory) return;
+	// Recording a new edit discards anything that could have been redone
+	if (journal->count == maxJournalEdits) {
+		journal->first = journalIndex(journal, 1);
+		--journal->count;
+	}
+	journal->edits[journalIndex(journal, journal->count)] = edit;
+	++journal->count;
+	journal->total = journal->count;
+	++journal->cursorLine;
+}
+
+// Moves to the edit's line and makes sure it still ends with the code the edit is expected to replace.
+// Counting lines goes wrong on the last line of the file or when the editor wraps lines.
+bool findEditLine(MappingJournal* journal, HWND window, MappingEdit& edit, uint expectedCode)
+{
+	if (!checkJournalHistory(journal)) {
+		journal->notice = "history cleared, cursor was moved";
+		return false;
+	}
+	if (GetForegroundWindow() != edit.window) {
+		clearJournalHistory(journal);
+		journal->notice = "history cleared, editor not focused";
+		return false;
+	}
+	moveCursorToLine(journal, edit.line);
+
+	char lineText[128];
+	uint code;
+	if (!copyCurrentLine(window, lineText, sizeof(lineText)) || !parseMappingCode(lineText, &code) || code != expectedCode) {
+		clearJournalHistory(journal);
+		journal->notice = "history cleared, line doesn't match";
+		return false;
+	}
+	return true;
+}
+
+bool undoButtonMapping(MappingJournal* journal, HWND window)
+{
+	if (journal->count == 0) return false;
+	MappingEdit& edit = journal->edits[journalIndex(journal, journal->count - 1)];
+	if (!edit.oldCodeKnown) {
+		journal->notice = "can't undo, previous code is unknown";
+		return false;
+	}
+	if (!findEditLine(journal, window, edit, edit.newCode)) return false;
+	--journal->count;
+	journal->notice = 0;
+	logEdit(journal, "undo", edit, true);
+
+	// Leave the cursor on the undone line so the next press maps it again
+	selectAndTypeMapping(edit.oldCode);
+	return true;
+}
+
+bool redoButtonMapping(MappingJournal* journal, HWND window)
+{
+	if (journal->count == journal->total) return false;
+	MappingEdit& edit = journal->edits[journalIndex(journal, journal->count)];
+	if (!findEditLine(journal, window, edit, edit.oldCode)) return false;
+	++journal->count;
+	journal->notice = 0;
+	logEdit(journal, "redo", edit, false);
+
+	selectAndTypeMapping(edit.newCode);
+	tapKey(VK_DOWN);
+	++journal->cursorLine;
+	return true;
 }
 
 LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -100,11 +649,65 @@ HWND createWindow()
 
 uint global_joystickCount = 0;
 Joystick* global_joysticks = 0;
+MappingJournal global_journal = { 0 };
+bool global_undoAvailable = false;
+// Undo and redo presses not applied yet, negative for undos
+int global_pendingRedos = 0;
+
+void updateWindowTitle(HWND window)
+{
+	char title[256] = "Fightcade Button Config";
+	if (!global_undoAvailable) strcat_s(title, " - undo unavailable");
+	if (global_journal.writeFailed) strcat_s(title, " - can't write log");
+	if (global_journal.lostEntries > 0) {
+		char lost[64];
+		sprintf_s(lost, " - %u log entries lost", global_journal.lostEntries);
+		strcat_s(title, lost);
+	}
+	if (global_journal.notice) {
+		strcat_s(title, " - ");
+		strcat_s(title, global_journal.notice);
+	}
+	SetWindowTextA(window, title);
+}
+
+// Undo and redo have to work while the text editor has focus. The input hooks that
+// make them safe are only installed while there is a history to protect.
+bool setupUndo(HWND window)
+{
+	if (!RegisterHotKey(window, HotKey_undo, hotKeyModifiers, undoHotKey)) return false;
+	if (!RegisterHotKey(window, HotKey_redo, hotKeyModifiers, redoHotKey)) {
+		UnregisterHotKey(window, HotKey_undo);
+		return false;
+	}
+	if (!startInputWatcher(&global_inputWatcher)) {
+		UnregisterHotKey(window, HotKey_undo);
+		UnregisterHotKey(window, HotKey_redo);
+		return false;
+	}
+	return true;
+}
+
+// Write the log next to the exe, wherever the program was started from
+void setJournalPath(MappingJournal* journal)
+{
+	DWORD length = GetModuleFileNameA(0, journal->path, sizeof(journal->path));
+	char* folderEnd = strrchr(journal->path, '\\');
+	if (length == 0 || length == sizeof(journal->path) || !folderEnd) {
+		strcpy_s(journal->path, "FightcadeButtonConfig.log");
+		return;
+	}
+	folderEnd[1] = 0;
+	strcat_s(journal->path, "FightcadeButtonConfig.log");
+}
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR szCmdLine, int iCmdShow)
 {
 	HWND window = createWindow();
 	global_joysticks = createJoysticks(&global_joystickCount);
+	setJournalPath(&global_journal);
+	global_undoAvailable = setupUndo(window);
+	updateWindowTitle(window);
 	bool run = true;
 	while (run) 
 	{
@@ -121,7 +724,22 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR szCmdLine,
 		updateJoysticks(global_joysticks, global_joystickCount);
 		uint inputCode = 0;
 		if (inputPressed(global_joysticks, global_joystickCount, &inputCode)) {
-			outputButtonMapping(inputCode);
+			outputButtonMapping(&global_journal, window, global_undoAvailable, inputCode);
+			updateWindowTitle(window);
+		}
+
+		// Wait for the hotkey's modifiers to be released so they don't apply to the simulated keys
+		if (global_pendingRedos != 0 && !(GetAsyncKeyState(VK_CONTROL) & 0x8000) && !(GetAsyncKeyState(VK_SHIFT) & 0x8000)) {
+			bool applied = true;
+			for (; global_pendingRedos < 0 && applied; ++global_pendingRedos) applied = undoButtonMapping(&global_journal, window);
+			for (; global_pendingRedos > 0 && applied; --global_pendingRedos) applied = redoButtonMapping(&global_journal, window);
+			global_pendingRedos = 0;
+			updateWindowTitle(window);
+		}
+
+		if ((global_journal.pendingLength > 0 || global_journal.droppedEntries > 0) && GetTickCount() - global_journal.lastEditTime > journalFlushDelay) {
+			flushJournal(&global_journal);
+			updateWindowTitle(window);
 		}
 		
 		// Swap buffers to align main loop with vsynch
@@ -129,6 +747,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR szCmdLine,
 		SwapBuffers(deviceContext);
 		ReleaseDC(window, deviceContext);
 	}
+	flushJournal(&global_journal);
+	if (global_inputWatcher.thread) {
+		PostThreadMessage(global_inputWatcher.threadId, WM_QUIT, 0, 0);
+		WaitForSingleObject(global_inputWatcher.thread, 1000);
+	}
 	return 0;
 }
 
@@ -138,6 +761,14 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
 		destroyJoysticks(global_joysticks, global_joystickCount);
 		global_joysticks = createJoysticks(&global_joystickCount);
 	}
+	if (msg == WM_HOTKEY) {
+		if (wParam == HotKey_undo) --global_pendingRedos;
+		if (wParam == HotKey_redo) ++global_pendingRedos;
+	}
+	if (msg == WM_ENDSESSION && wParam) {
+		// The process can end without reaching the end of WinMain
+		flushJournal(&global_journal);
+	}
 	if (msg == WM_DESTROY) {
 		PostQuitMessage(0);
 		return 0;